@@ -0,0 +1,88 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include <SFML/Graphics.hpp>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+
+/*
+    Glyph atlas written by `bitmapgenerator --batch` and read by drawText:
+
+        AtlasHeader
+        AtlasSize[sizeCount]
+        one coverage image per size, a byte per pixel
+
+    Each image is a grid of square slots atlasColumns wide, glyph
+    first + i in slot (i % atlasColumns, i / atlasColumns). A slot is the
+    glyph's cell with atlasPadding empty pixels on every side, so smooth
+    scaling never samples a neighbouring glyph. Offsets are from the start of
+    the file.
+*/
+
+const char atlasMagic[4] = {'G', 'L', 'Y', 'F'};
+const int atlasColumns = 16;
+const int atlasPadding = 2;
+const int atlasMaxGlyphs = 95;     // printable ASCII
+const int atlasMaxPixelSize = 512;
+const int atlasMaxCell = 2 * atlasMaxPixelSize; // cells are clipped to this
+
+struct AtlasHeader
+{
+    char magic[4];
+    uint32_t first, count, sizeCount;
+};
+
+struct AtlasSize
+{
+    uint32_t pixelSize; // size the font was rasterised at
+    uint32_t cell;      // width and height of each cell
+    uint32_t offset;
+};
+
+constexpr uint32_t atlasSlot(uint32_t cell)
+{
+    return cell + 2 * atlasPadding;
+}
+
+constexpr uint32_t atlasRows(uint32_t count)
+{
+    return (count + atlasColumns - 1) / atlasColumns;
+}
+
+// Bytes in the image of one size
+constexpr uint64_t atlasBytes(uint32_t cell, uint32_t count)
+{
+    return (uint64_t)atlasSlot(cell) * atlasSlot(cell) * atlasColumns * atlasRows(count);
+}
+
+// Read a whole atlas file. Returns false if it is missing or not an atlas.
+bool readAtlas(const std::string& path, AtlasHeader& header, std::vector<AtlasSize>& sizes, std::vector<uint8_t>& data)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+        return false;
+
+    data.resize(file.tellg());
+    file.seekg(0);
+    if (!file.read((char*)data.data(), data.size()) || data.size() < sizeof(header))
+        return false;
+
+    memcpy(&header, data.data(), sizeof(header));
+    if (memcmp(header.magic, atlasMagic, sizeof(atlasMagic)) != 0 || header.count > atlasMaxGlyphs ||
+        data.size() < sizeof(header) + (uint64_t)header.sizeCount * sizeof(AtlasSize))
+        return false;
+
+    sizes.resize(header.sizeCount);
+    memcpy(sizes.data(), data.data() + sizeof(header), header.sizeCount * sizeof(AtlasSize));
+
+    for (const AtlasSize& size : sizes)
+        if (size.cell == 0 || size.cell > atlasMaxCell || size.offset + atlasBytes(size.cell, header.count) > data.size())
+            return false;
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include "libs.hpp"
+#include "tetris.hpp"
+
+// Compact board for simulation outside of the drawn game: bit x of row y is
+// set when tiles[y][x] != N. Row 0 is the bottom, as in tiles.
+typedef array<uint16_t, 20> Bitboard;
+
+const uint16_t fullRow = (1 << 10) - 1;
+const array<int, 5> lineScores({0, 40, 100, 300, 1200});
+
+// A tetromino dropped at tetPos (x, y), taken from hold if hold is set
+struct Placement
+{
+    int tet, rot, x, y;
+    bool hold;
+};
+
+Bitboard toBitboard(const vector<vector<int>>& tiles)
+{
+    Bitboard board{};
+    for (int y = 0; y < board.size(); ++y)
+        for (int x = 0; x < boardDim.x; ++x)
+            if (tiles[y][x] != N)
+                board[y] |= 1 << x;
+
+    return board;
+}
+
+// Bits of row k of a tetromino moved to column x, or -1 if part of it falls
+// off either side of the board
+int pieceRow(int tet, int rot, int k, int x)
+{
+    int bits = tetrominos[tet][rot % 4] >> (k * 4) & 0xf;
+    if (x < 0)
+    {
+        if (bits & ((1 << -x) - 1))
+            return -1;
+        return bits >> -x;
+    }
+
+    bits <<= x;
+    return (bits & ~fullRow) ? -1 : bits;
+}
+
+// Same rules as collisionCheck: nothing below the floor or outside the walls,
+// and cells above the top row are free
+bool fits(const Bitboard& board, int tet, int rot, int x, int y)
+{
+    for (int k = 0; k < 4; ++k)
+    {
+        int bits = pieceRow(tet, rot, k, x);
+        if (bits == 0)
+            continue;
+
+        if (bits == -1 || y + k < 0 || (y + k < board.size() && board[y + k] & bits))
+            return false;
+    }
+
+    return true;
+}
+
+// Lowest y a tetromino reaches when hard dropped from y
+int dropY(const Bitboard& board, int tet, int rot, int x, int y)
+{
+    while (fits(board, tet, rot, x, y - 1))
+        --y;
+
+    return y;
+}
+
+// Place a tetromino and clear full rows. Returns rows cleared, or -1 if part
+// of the tetromino is left above the board.
+int place(Bitboard& board, int tet, int rot, int x, int y)
+{
+    for (int k = 0; k < 4; ++k)
+    {
+        int bits = pieceRow(tet, rot, k, x);
+        if (bits == 0)
+            continue;
+
+        if (y + k >= board.size())
+            return -1;
+        board[y + k] |= bits;
+    }
+
+    int rows = 0;
+    for (int y = 0; y < board.size(); ++y)
+    {
+        if (board[y] == fullRow)
+            ++rows;
+        else
+            board[y - rows] = board[y];
+    }
+
+    for (int y = board.size() - rows; y < board.size(); ++y)
+        board[y] = 0;
+
+    return rows;
+}
+
+#endif
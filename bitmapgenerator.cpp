@@ -3,7 +3,12 @@
 #include <fstream>
 #include <math.h>
 #include <array>
-#include <sstream>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <climits>
+#include "atlas.hpp"
 
 using namespace sf;
 using namespace std;
@@ -17,7 +22,7 @@ const Color gridColor(255, 255, 255, 80);
 
 // state vars
 RectangleShape rect(tileSize);
-RenderWindow win(VideoMode(WIDTH, HEIGHT), "win", Style::Titlebar);
+RenderWindow win; // only opened when painting by hand
 array<array<bool, X_TILES>, Y_TILES> selection;
 vector<array<uint8_t, Y_TILES>> output;
 char current = '!';
@@ -94,14 +99,9 @@ void draw()
 
 string toHex(uint8_t val)
 {
-    stringstream ss;
-    ss << hex << unsigned(val);
-
-    string hex = ss.str();
-    if (hex.size() == 1)
-        return "0x0"+hex;
-    else
-        return "0x"+hex;
+    char hex[5];
+    snprintf(hex, sizeof(hex), "0x%02x", val);
+    return hex;
 }
 
 void writeToFile()
@@ -131,15 +131,199 @@ void writeToFile()
     File.close();
 }
 
-int main()
+/*
+    Batch mode: rasterise every printable ASCII glyph of a font at each size
+    offscreen and write <out>.bin, an atlas the game loads at startup (format in
+    atlas.hpp), and <out>.hpp, the same layout as constexpr values.
+*/
+
+const uint32_t batchFirst = 32;
+const uint32_t batchCount = 95; // ' ' to '~'
+
+// Copy one glyph's coverage out of the font page into the cell at out,
+// centred on its advance
+void blitGlyph(const Image& page, const Glyph& glyph, uint8_t* out, int cell, int baseline)
+{
+    int stride = atlasSlot(cell) * atlasColumns;
+    int left = floor((cell - glyph.advance) / 2 + glyph.bounds.left);
+    int top = floor(baseline + glyph.bounds.top);
+
+    for (int y = 0; y < glyph.textureRect.height; ++y)
+        for (int x = 0; x < glyph.textureRect.width; ++x)
+        {
+            int cx = left + x, cy = top + y;
+            if (cx < 0 || cy < 0 || cx >= cell || cy >= cell)
+                continue;
+
+            Color pixel = page.getPixel(glyph.textureRect.left + x, glyph.textureRect.top + y);
+            out[cy * stride + cx] = pixel.a;
+        }
+}
+
+// Rasterise every glyph at pixelSize into the image for one size, each cell
+// as big as the tallest glyph or widest advance
+void rasterise(Font& font, uint32_t pixelSize, uint32_t& cell, vector<uint8_t>& pixels)
+{
+    float ascent = 0, descent = 0, advance = 0;
+    for (uint32_t c = batchFirst; c < batchFirst + batchCount; ++c)
+    {
+        const Glyph& glyph = font.getGlyph(c, pixelSize, false);
+        ascent = max(ascent, -glyph.bounds.top);
+        descent = max(descent, glyph.bounds.top + glyph.bounds.height);
+        advance = max(advance, glyph.advance);
+    }
+
+    cell = min<uint32_t>(max(1.0f, ceil(max(ascent + descent, advance))), atlasMaxCell);
+    pixels.assign(atlasBytes(cell, batchCount), 0);
+
+    Image page = font.getTexture(pixelSize).copyToImage();
+    uint32_t slot = atlasSlot(cell);
+    for (uint32_t i = 0; i < batchCount; ++i)
+    {
+        uint32_t x = i % atlasColumns * slot + atlasPadding;
+        uint32_t y = i / atlasColumns * slot + atlasPadding;
+        blitGlyph(page, font.getGlyph(batchFirst + i, pixelSize, false), &pixels[y * slot * atlasColumns + x], cell, ceil(ascent));
+    }
+}
+
+int batch(const string& fontPath, const string& sizeList, const string& out)
+{
+    vector<uint32_t> pixelSizes;
+    for (size_t start = 0; start < sizeList.size();)
+    {
+        size_t end = sizeList.find(',', start);
+        if (end == string::npos)
+            end = sizeList.size();
+
+        string size = sizeList.substr(start, end - start);
+        char* last;
+        long pixelSize = strtol(size.c_str(), &last, 10);
+        if (size.empty() || *last != '\0' || pixelSize < 1 || pixelSize > atlasMaxPixelSize)
+        {
+            printf("Invalid size \"%s\", sizes are 1 to %d\n", size.c_str(), atlasMaxPixelSize);
+            return -1;
+        }
+
+        pixelSizes.push_back(pixelSize);
+        start = end + 1;
+    }
+
+    if (pixelSizes.empty())
+    {
+        printf("No sizes given\n");
+        return -1;
+    }
+
+    // every thread rasterises whole sizes with its own copy of the font, so
+    // each has its own FreeType face and glyph pages
+    vector<uint32_t> cells(pixelSizes.size());
+    vector<vector<uint8_t>> images(pixelSizes.size());
+    atomic<int> next(0);
+    atomic<bool> failed(false);
+
+    vector<thread> workers;
+    for (int i = 0; i < min<size_t>(max(1u, thread::hardware_concurrency()), pixelSizes.size()); ++i)
+        workers.push_back(thread([&]()
+        {
+            Context context; // textures need a GL context on this thread
+            Font threadFont;
+            if (!threadFont.loadFromFile(fontPath))
+            {
+                failed = true;
+                return;
+            }
+
+            for (int s = next++; s < pixelSizes.size(); s = next++)
+                rasterise(threadFont, pixelSizes[s], cells[s], images[s]);
+        }));
+
+    for (thread& t : workers)
+        t.join();
+
+    if (failed)
+    {
+        printf("Error loading font!");
+        return -1;
+    }
+
+    AtlasHeader header = {{}, batchFirst, batchCount, (uint32_t)pixelSizes.size()};
+    memcpy(header.magic, atlasMagic, sizeof(atlasMagic));
+
+    vector<AtlasSize> sizes;
+    uint64_t offset = sizeof(header) + pixelSizes.size() * sizeof(AtlasSize);
+    for (int s = 0; s < pixelSizes.size(); ++s)
+    {
+        sizes.push_back({pixelSizes[s], cells[s], (uint32_t)offset});
+        offset += images[s].size();
+    }
+
+    if (offset > UINT32_MAX)
+    {
+        printf("Atlas is too big, use fewer or smaller sizes\n");
+        return -1;
+    }
+
+    vector<uint8_t> data;
+    data.reserve(offset);
+    data.insert(data.end(), (const uint8_t*)&header, (const uint8_t*)&header + sizeof(header));
+    data.insert(data.end(), (const uint8_t*)sizes.data(), (const uint8_t*)(sizes.data() + sizes.size()));
+    for (const vector<uint8_t>& image : images)
+        data.insert(data.end(), image.begin(), image.end());
+
+    ofstream bin(out + ".bin", ios::binary);
+    bin.write((const char*)data.data(), data.size());
+    bin.close();
+
+    ofstream hpp(out + ".hpp");
+    hpp << "// Generated by bitmapgenerator --batch from " << fontPath << ", layout of " << out << ".bin" << endl
+        << "#ifndef GLYPHS_H" << endl
+        << "#define GLYPHS_H" << endl << endl
+        << "#include <array>" << endl
+        << "#include <cstdint>" << endl << endl
+        << "constexpr int glyphFirst = " << batchFirst << ";" << endl
+        << "constexpr int glyphCount = " << batchCount << ";" << endl
+        << "constexpr int glyphColumns = " << atlasColumns << ";" << endl
+        << "constexpr int glyphPadding = " << atlasPadding << ";" << endl;
+
+    const char* names[3] = {"glyphPixelSizes", "glyphCells", "glyphOffsets"};
+    for (int n = 0; n < 3; ++n)
+    {
+        hpp << "constexpr std::array<uint32_t, " << sizes.size() << "> " << names[n] << " = {";
+        for (int s = 0; s < sizes.size(); ++s)
+            hpp << (s ? ", " : "") << (n == 0 ? sizes[s].pixelSize : n == 1 ? sizes[s].cell : sizes[s].offset);
+        hpp << "};" << endl;
+    }
+
+    hpp << endl << "#endif" << endl;
+    hpp.close();
+
+    return 0;
+}
+
+// bitmapgenerator [font.ttf] paints glyphs by hand,
+// bitmapgenerator --batch <font.ttf> <size,size,...> <out> builds an atlas
+int main(int argc, char** argv)
 {
+    if (argc > 1 && string(argv[1]) == "--batch")
+    {
+        if (argc < 5)
+        {
+            printf("Usage: bitmapgenerator --batch <font.ttf> <size,size,...> <out>\n");
+            return -1;
+        }
+
+        return batch(argv[2], argv[3], argv[4]);
+    }
+
     Event event;
-    if (!font.loadFromFile("/usr/share/fonts/CascadiaCode.ttf"))
+    if (!font.loadFromFile(argc > 1 ? argv[1] : "/usr/share/fonts/CascadiaCode.ttf"))
     {
         printf("Error loading font!");
         return -1;
     }
 
+    win.create(VideoMode(WIDTH, HEIGHT), "win", Style::Titlebar);
+
     fill();
     
     rect.setOutlineThickness(0);
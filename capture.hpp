@@ -0,0 +1,234 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include "libs.hpp"
+#define GL_GLEXT_PROTOTYPES
+#include <SFML/OpenGL.hpp>
+#include <GL/glext.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+
+// Offscreen frame capture. Each frame is read into one of two pixel buffer
+// objects while the frame before it is copied out of the other, so the render
+// loop never waits on the transfer. Copies go into a fixed pool of buffers
+// handed to writer threads through a bounded queue, so it never touches the
+// disk or the encoder either.
+
+const int captureQueueSize = 32; // frames in flight between render and writers
+
+struct CapturedFrame
+{
+    int index;
+    vector<Uint8> pixels; // RGBA, bottom row first (as read from OpenGL)
+};
+
+RenderTexture* captureTarget;
+int captureWidth, captureHeight;
+string captureDir;          // image sequence directory, empty when piping
+FILE* capturePipe = nullptr; // encoder stdin, null when writing images
+
+vector<unique_ptr<CapturedFrame>> captureFrames; // owns every buffer
+deque<CapturedFrame*> captureQueue;              // filled, waiting to be written
+deque<CapturedFrame*> captureFree;               // written, ready for reuse
+vector<thread> captureWorkers;
+mutex captureMutex;
+condition_variable captureFilled, captureDrained;
+bool captureDone;
+int captureCount;
+
+GLuint capturePBOs[2];
+int captureReads; // frames read into capturePBOs, alternating between them
+
+void writeFrame(CapturedFrame* frame)
+{
+    FILE* file = capturePipe;
+    char name[32];
+
+    if (!file)
+    {
+        snprintf(name, sizeof(name), "/frame_%06d.pam", frame->index);
+
+        file = fopen((captureDir + name).c_str(), "wb");
+        if (!file)
+        {
+            cerr << "Error writing " << captureDir << name << endl;
+            return;
+        }
+
+        fprintf(file, "P7\nWIDTH %d\nHEIGHT %d\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n",
+                captureWidth, captureHeight);
+    }
+
+    // flip to top row first while writing
+    const size_t stride = captureWidth * 4;
+    for (int y = captureHeight - 1; y >= 0; --y)
+        fwrite(&frame->pixels[y * stride], 1, stride, file);
+
+    if (file != capturePipe)
+        fclose(file);
+}
+
+void captureWorker()
+{
+    while (true)
+    {
+        CapturedFrame* frame;
+        {
+            unique_lock<mutex> lock(captureMutex);
+            captureFilled.wait(lock, [] { return captureDone || !captureQueue.empty(); });
+
+            if (captureQueue.empty())
+                return; // done and drained
+
+            frame = captureQueue.front();
+            captureQueue.pop_front();
+        }
+
+        writeFrame(frame);
+
+        {
+            lock_guard<mutex> lock(captureMutex);
+            captureFree.push_back(frame);
+        }
+        captureDrained.notify_one();
+    }
+}
+
+// Start capturing frames of target. Writes an image sequence into dir, or
+// pipes raw RGBA frames to the stdin of encoder if it is non-empty.
+bool captureStart(RenderTexture& target, const string& dir, const string& encoder)
+{
+    captureTarget = &target;
+    captureWidth = target.getSize().x;
+    captureHeight = target.getSize().y;
+    captureDir = dir;
+    captureDone = false;
+    captureCount = 0;
+    captureReads = 0;
+
+    if (!dir.empty())
+    {
+        struct stat info;
+        mkdir(dir.c_str(), 0755);
+        if (stat(dir.c_str(), &info) != 0 || !S_ISDIR(info.st_mode))
+        {
+            cerr << "Error creating directory " << dir << endl;
+            return false;
+        }
+    }
+
+    if (!encoder.empty())
+    {
+        capturePipe = popen(encoder.c_str(), "w");
+        if (!capturePipe)
+        {
+            cerr << "Error starting encoder: " << encoder << endl;
+            return false;
+        }
+    }
+
+    for (int i = 0; i < captureQueueSize; ++i)
+    {
+        captureFrames.push_back(unique_ptr<CapturedFrame>(new CapturedFrame));
+        captureFrames.back()->pixels.resize(captureWidth * captureHeight * 4);
+        captureFree.push_back(captureFrames.back().get());
+    }
+
+    // a pipe needs frames in order, so it gets a single writer
+    int workers = capturePipe ? 1 : max(2u, thread::hardware_concurrency()) - 1;
+    for (int i = 0; i < workers; ++i)
+        captureWorkers.push_back(thread(captureWorker));
+
+    target.setActive(true);
+    glGenBuffers(2, capturePBOs);
+    for (GLuint pbo : capturePBOs)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, captureWidth * captureHeight * 4, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    return true;
+}
+
+// Copy a finished transfer out of pbo and queue it for writing. Only blocks
+// if every buffer is still waiting on the writers.
+void captureCollect(GLuint pbo)
+{
+    CapturedFrame* frame;
+    {
+        unique_lock<mutex> lock(captureMutex);
+        captureDrained.wait(lock, [] { return !captureFree.empty(); });
+
+        frame = captureFree.front();
+        captureFree.pop_front();
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+    const void* pixels = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+    if (pixels)
+        memcpy(frame->pixels.data(), pixels, frame->pixels.size());
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    frame->index = captureCount++;
+
+    {
+        lock_guard<mutex> lock(captureMutex);
+        captureQueue.push_back(frame);
+    }
+    captureFilled.notify_one();
+}
+
+// Start reading back the last finished frame of the target, and queue the
+// frame read before it, which has had a whole frame to arrive.
+void captureFrame()
+{
+    captureTarget->setActive(true);
+
+    GLuint pbo = capturePBOs[captureReads % 2];
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+    glReadPixels(0, 0, captureWidth, captureHeight, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+    if (captureReads++ > 0)
+        captureCollect(capturePBOs[captureReads % 2]);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+// Flush queued frames and shut down the writers and encoder.
+void captureStop()
+{
+    captureTarget->setActive(true);
+    if (captureReads > 0)
+        captureCollect(capturePBOs[(captureReads - 1) % 2]);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glDeleteBuffers(2, capturePBOs);
+
+    {
+        lock_guard<mutex> lock(captureMutex);
+        captureDone = true;
+    }
+    captureFilled.notify_all();
+
+    for (thread& t : captureWorkers)
+        t.join();
+    captureWorkers.clear();
+
+    if (capturePipe)
+    {
+        pclose(capturePipe);
+        capturePipe = nullptr;
+    }
+
+    captureQueue.clear();
+    captureFree.clear();
+    captureFrames.clear();
+}
+
+#endif
@@ -1,4 +1,11 @@
+#ifndef FONT_H
+#define FONT_H
+
 #include "libs.hpp"
+#include "atlas.hpp"
+#include <algorithm>
+#include <climits>
+#include <unistd.h>
 
 // 95 character 8x8 bitmap font, top and left is empty column
 const array<array<uint8_t, 8>, 1> nesfont({
@@ -104,35 +111,115 @@ unsigned char letters[96][8] = {
     {0xfe, 0xc6, 0xc6, 0x6c, 0x38, 0x10, 0x00, 0x00},
 };
 
-void drawText(string text, int sqsize, Vector2f pos, Color color, RenderWindow& win)
+const string glyphAtlasName = "glyphs.bin";
+
+// The atlas sits next to the executable, falling back to the working directory
+string glyphAtlasPath()
 {
-    float pix = sqsize/8.0f;
-    RectangleShape pixel(Vector2f(pix, pix));
-    pixel.setFillColor(color);
-    pixel.setOutlineThickness(0);
+    char exe[PATH_MAX];
+    ssize_t len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    if (len <= 0)
+        return glyphAtlasName;
 
-    Vector2f base(pos.x + sqsize, pos.y + sqsize);
+    string path(exe, len);
+    return path.substr(0, path.rfind('/') + 1) + glyphAtlasName;
+}
 
-    for (int c = 0; c < text.size(); ++c)
+// Glyph texture drawText draws from, one per rasterised size
+struct GlyphSet
+{
+    Texture texture;
+    int first, count;
+    int cell;     // pixels per glyph square
+    int padding;  // empty pixels around each cell
+    float offset; // downward shift in glyph squares
+};
+
+vector<GlyphSet> glyphSets; // smallest cell first
+
+// Load the atlas made by bitmapgenerator --batch if there is one, otherwise
+// expand letters into a texture once
+void loadGlyphs()
+{
+    AtlasHeader header;
+    vector<AtlasSize> sizes;
+    vector<uint8_t> data;
+
+    if (readAtlas(glyphAtlasPath(), header, sizes, data) || readAtlas(glyphAtlasName, header, sizes, data))
     {
-        // set pixel to top right of square
-        pixel.setPosition(base);
+        // sorted and reserved up front, so textures are never copied
+        sort(sizes.begin(), sizes.end(), [](const AtlasSize& a, const AtlasSize& b) { return a.cell < b.cell; });
+        glyphSets.reserve(sizes.size());
+
+        for (const AtlasSize& size : sizes)
+        {
+            int width = atlasSlot(size.cell) * atlasColumns;
+            int height = atlasSlot(size.cell) * atlasRows(header.count);
+
+            // white, with the coverage as alpha so sprites can be tinted
+            vector<Uint8> pixels(width * height * 4, 255);
+            for (int i = 0; i < width * height; ++i)
+                pixels[i * 4 + 3] = data[size.offset + i];
+
+            Image image;
+            image.create(width, height, pixels.data());
+
+            glyphSets.push_back({Texture(), (int)header.first, (int)header.count, (int)size.cell, atlasPadding, 0});
+            glyphSets.back().texture.loadFromImage(image);
+            glyphSets.back().texture.setSmooth(true);
+        }
+
+        if (!glyphSets.empty())
+            return;
+    }
+
+    // letters rows are stored bottom up, and were always drawn one pixel low
+    Image image;
+    image.create(8 * atlasColumns, 8 * atlasRows(96), Color::Transparent);
+
+    for (int c = 0; c < 96; ++c)
         for (int row = 0; row < 8; ++row)
+            for (int col = 0; col < 8; ++col)
+                if (letters[c][row] >> col & 1)
+                    image.setPixel(c % atlasColumns * 8 + col, c / atlasColumns * 8 + 7 - row, Color::White);
+
+    glyphSets.push_back({Texture(), 32, 96, 8, 0, 1 / 8.0f});
+    glyphSets.back().texture.loadFromImage(image);
+}
+
+void drawText(string text, int sqsize, Vector2f pos, Color color, RenderTarget& target)
+{
+    if (glyphSets.empty())
+        loadGlyphs();
+
+    // smallest set that only needs scaling down, or the biggest one
+    const GlyphSet* set = &glyphSets.back();
+    for (const GlyphSet& s : glyphSets)
+        if (s.cell >= sqsize)
         {
-            for (int col = 7; col >= 0; --col)
-            {
-                // lower pixel 1 col
-                pixel.setPosition(pixel.getPosition().x - pix, pixel.getPosition().y);
-                uint8_t current = letters[text[c]-32][row];
-                if (current >> col & 1 == 1)
-                    win.draw(pixel);
-            }
-
-            // lower pixel 1 row
-            pixel.setPosition(pixel.getPosition().x + sqsize, pixel.getPosition().y - pix);
+            set = &s;
+            break;
         }
 
-        // inc square
-        base.x += sqsize;
+    float scale = (float)sqsize / set->cell;
+
+    Sprite glyph;
+    glyph.setTexture(set->texture);
+    glyph.setColor(color);
+    glyph.setScale(scale, scale);
+
+    for (int c = 0; c < text.size(); ++c)
+    {
+        int i = text[c] - set->first;
+        if (i < 0 || i >= set->count)
+            continue;
+
+        int slot = set->cell + 2 * set->padding;
+        glyph.setTextureRect(IntRect(i % atlasColumns * slot + set->padding, i / atlasColumns * slot + set->padding,
+                                     set->cell, set->cell));
+        glyph.setPosition(pos.x + c * sqsize, pos.y + set->offset * sqsize);
+        target.draw(glyph);
     }
 }
+
+#endif
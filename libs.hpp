@@ -8,6 +8,7 @@
 #include <math.h>
 #include <string>
 #include <array>
+#include <deque>
 
 using namespace std;
 using namespace sf;
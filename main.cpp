@@ -7,8 +7,24 @@
 
 #include "libs.hpp"
 #include "tetris.hpp"
+#include "capture.hpp"
+#include "placer.hpp"
+#include "selfplay.hpp"
+#include "pcsolver.hpp"
+#include <future>
+#include <cerrno>
+#include <climits>
 
 const bool useGrid = false;
+const Uint8 hintAlpha = 90;
+
+// perfect clear hint, searched in the background for the state it was started from
+bool showHint = false;
+future<PCResult> hintSearch;
+PCResult hint = {pcNone, {}};
+Bitboard hintBoard;
+vector<int> hintQueue;
+int hintHeld;
 
 void pad0(string& s, int len)
 {
@@ -16,36 +32,64 @@ void pad0(string& s, int len)
         s.insert(s.begin(), '0');
 }
 
+void updateHint()
+{
+    if (hintSearch.valid())
+    {
+        if (hintSearch.wait_for(chrono::seconds(0)) != future_status::ready)
+            return;
+
+        hint = hintSearch.get();
+    }
+
+    Bitboard board = toBitboard(tiles);
+    vector<int> queue = {currentTet, nextTet};
+    queue.insert(queue.end(), preview.begin(), preview.end());
+
+    if (board != hintBoard || queue != hintQueue || heldTet != hintHeld)
+    {
+        hint = {pcNone, {}};
+        hintBoard = board;
+        hintQueue = queue;
+        hintHeld = heldTet;
+
+        // no more pieces than are known, counting the held one
+        int known = queue.size() + (heldTet != N);
+        hintSearch = async(launch::async, pcSolve, board, queue, heldTet, !usedHeld, min(10, known), 1000);
+    }
+}
+
 void updateGame()
 {
     if (lost)
     {
-        drawText("YOU LOST", fontSize, Vector2f(lostX, pausePos.y + fontSize * lostFontMul), Color::White, win);
+        drawText("YOU LOST", fontSize, Vector2f(lostX, pausePos.y + fontSize * lostFontMul), Color::White, *screen);
 
         // draw score
         string s = to_string(score);
         pad0(s, 6);
-        drawText("SCORE: "+s, fontSize, Vector2f(scorePos.x, pausePos.y + fontSize * (lostFontMul + 2)), Color::White, win);
+        drawText("SCORE: "+s, fontSize, Vector2f(scorePos.x, pausePos.y + fontSize * (lostFontMul + 2)), Color::White, *screen);
 
         // draw lines
         s = to_string(lines);
         pad0(s, 3);
-        drawText("LINES: "+s, fontSize, Vector2f(linesPos.x, pausePos.y + fontSize * (lostFontMul + 4)), Color::White, win);
+        drawText("LINES: "+s, fontSize, Vector2f(linesPos.x, pausePos.y + fontSize * (lostFontMul + 4)), Color::White, *screen);
 
         // draw level
         s = to_string(level);
         pad0(s, 2);
-        drawText("LEVEL: "+s, fontSize, Vector2f(levelPos.x, pausePos.y + fontSize * (lostFontMul + 6)), Color::White, win);
+        drawText("LEVEL: "+s, fontSize, Vector2f(levelPos.x, pausePos.y + fontSize * (lostFontMul + 6)), Color::White, *screen);
 
         // draw prompt
-        drawText("PRESS ENTER TO", fontSize, Vector2f(pressX, pausePos.y + fontSize * (lostFontMul + 9)), Color::White, win);
-        drawText("PLAY AGAIN", fontSize, Vector2f(linesPos.x, pausePos.y + fontSize * (lostFontMul + 11)), Color::White, win);
+        drawText("PRESS ENTER TO", fontSize, Vector2f(pressX, pausePos.y + fontSize * (lostFontMul + 9)), Color::White, *screen);
+        drawText("PLAY AGAIN", fontSize, Vector2f(linesPos.x, pausePos.y + fontSize * (lostFontMul + 11)), Color::White, *screen);
 
         return;
     }
 
     // update game if timer > frame count (depending on if soft dropping)
-    if (!paused && frameTimer >= (softDrop ? softFrames[level] : frames[level]))
+    int speed = min(level, (int)frames.size() - 1); // speed stops increasing past the table
+    if (!paused && frameTimer >= (softDrop ? softFrames[speed] : frames[speed]))
     {
         if (collisionCheck(0, 0))
             tetPos = Vector2f(tetPos.x, tetPos.y - 1);
@@ -62,7 +106,7 @@ void updateGame()
     board.setOutlineColor(Color::White);
     board.setPosition(boardPos);
 
-    win.draw(board);
+    screen->draw(board);
 
     // draw grid
     if (useGrid)
@@ -73,34 +117,34 @@ void updateGame()
         for (int x = 1; x < boardDim.x; ++x)
         {
             line.setPosition(Vector2f(boardPos.x + x * tileSize, boardPos.y));
-            win.draw(line);
+            screen->draw(line);
         }
 
         line.setSize(Vector2f(tileSize * boardDim.x, 1));
         for (int y = 1; y < boardDim.y; ++y)
         {
             line.setPosition(Vector2f(boardPos.x, boardPos.y + y * tileSize));
-            win.draw(line);
+            screen->draw(line);
         }
     }
 
     // draw score
     string s = to_string(score);
     pad0(s, 6);
-    drawText("SCORE: "+s, fontSize, scorePos, Color::White, win);
+    drawText("SCORE: "+s, fontSize, scorePos, Color::White, *screen);
 
     // draw lines
     s = to_string(lines);
     pad0(s, 3);
-    drawText("LINES: "+s, fontSize, linesPos, Color::White, win);
+    drawText("LINES: "+s, fontSize, linesPos, Color::White, *screen);
 
     // draw level
     s = to_string(level);
     pad0(s, 2);
-    drawText("LEVEL: "+s, fontSize, levelPos, Color::White, win);
+    drawText("LEVEL: "+s, fontSize, levelPos, Color::White, *screen);
 
     if (paused)
-        drawText("PAUSED", fontSize, pausePos, Color::White, win);
+        drawText("PAUSED", fontSize, pausePos, Color::White, *screen);
     else
     {
         // draw tiles
@@ -112,14 +156,36 @@ void updateGame()
 
                     tile.setFillColor(COLORS[tiles[y][x]]);
                     tile.setPosition(boardPos + Vector2f(tileSize * x, tileSize * ypos));
-                    win.draw(tile);
+                    screen->draw(tile);
                 }
 
         // draw falling tet
         drawTet(tetPos.x, tetPos.y, currentTet, rotation, true);
 
-        // draw next
+        // draw next and preview
         drawTet(nextTetPos.x, nextTetPos.y, nextTet, displayRot, false);
+        for (int i = 0; i < preview.size(); ++i)
+            drawMiniTet(boardPos + Vector2f(nextTetPos.x * tileSize, previewTop * tileSize + i * previewSpacing * tileSize / 2.0f), preview[i]);
+
+        // draw first move of the perfect clear hint, lighting up the hold
+        // slot when the move starts by holding
+        if (showHint)
+        {
+            updateHint();
+            if (hint.status == pcFound)
+            {
+                const Placement& move = hint.moves[0];
+                drawTet(move.x, move.y, move.tet, move.rot, true, hintAlpha);
+
+                if (move.hold)
+                {
+                    RectangleShape holdBox(Vector2f(4, 4) * (float)tileSize);
+                    holdBox.setFillColor(Color(255, 255, 255, hintAlpha / 2));
+                    holdBox.setPosition(boardPos + Vector2f(heldTetPos.x, boardDim.y - heldTetPos.y - 4) * (float)tileSize);
+                    screen->draw(holdBox);
+                }
+            }
+        }
 
         // draw held
         if (heldTet != N)
@@ -156,8 +222,12 @@ void init()
         tiles.push_back(temp);
     }
 
-    nextTet = rand() % N;
-    currentTet = rand() % N;
+    preview.clear();
+    for (int i = 0; i < previewSize; ++i)
+        preview.push_back(rand() % N);
+
+    nextTet = pullTet();
+    currentTet = pullTet();
 }
 
 void input(int code)
@@ -206,7 +276,7 @@ void input(int code)
             {
                 heldTet = currentTet;
                 currentTet = nextTet;
-                nextTet = rand() % N;
+                nextTet = pullTet();
             }
             tetPos = spawnPos;
             rotation = 0;
@@ -216,34 +286,213 @@ void input(int code)
 
     if (code == Keyboard::P || code == Keyboard::Escape)
         paused = !paused;
+    else if (code == Keyboard::H)
+        showHint = !showHint;
+}
+
+void handleEvent(Event& event)
+{
+    if (event.type == Event::KeyPressed)
+        input(event.key.code);
+    else if (event.type == Event::Closed)
+        win.close();
 }
 
-int main()
+// Drive the game with the greedy placer, pressing one key per frame like a
+// player would: hold if it wants to, rotate, shift, then hard drop
+void autoplay()
+{
+    if (lost || paused)
+        return;
+
+    Placement target{};
+    if (!choosePlacement(toBitboard(tiles), currentTet, nextTet, heldTet, !usedHeld, tetPos.y, target))
+    {
+        input(Keyboard::Space);
+        return;
+    }
+
+    Vector2f pos = tetPos;
+    int rot = rotation;
+    int code = Keyboard::Space;
+
+    if (target.hold)
+        code = Keyboard::C;
+    else if (rotation % 4 != target.rot)
+        code = Keyboard::Up;
+    else if (tetPos.x < target.x)
+        code = Keyboard::Right;
+    else if (tetPos.x > target.x)
+        code = Keyboard::Left;
+
+    input(code);
+
+    // blocked on the way there, drop where it is
+    if (code != Keyboard::Space && code != Keyboard::C && pos.x == tetPos.x && rot == rotation)
+        input(Keyboard::Space);
+}
+
+// Render the game offscreen as fast as possible, handing every frame to the
+// capture writers
+int renderHeadless(int frameLimit, const string& dir, const string& encoder)
+{
+    RenderTexture buffer;
+    if (!buffer.create(winSize.x, winSize.y))
+    {
+        cerr << "Error creating render texture" << endl;
+        return -1;
+    }
+
+    if (!captureStart(buffer, dir, encoder))
+        return -1;
+
+    screen = &buffer;
+
+    int f = 0;
+    bool over = false;
+    while (f < frameLimit && !over)
+    {
+        over = lost; // render the game over screen once, then stop
+
+        autoplay();
+
+        buffer.clear();
+        updateGame();
+        buffer.display();
+        captureFrame();
+
+        ++frameTimer;
+        ++f;
+    }
+
+    captureStop();
+    screen = &win;
+
+    cout << "Rendered " << f << " frames" << endl;
+    return 0;
+}
+
+// Parse a positive count argument, printing an error for anything else
+bool parseCount(const string& arg, const char* value, uint64_t& count)
+{
+    char* end;
+    errno = 0;
+    count = strtoull(value, &end, 10);
+
+    if (errno != 0 || end == value || *end != '\0' || value[0] == '-' || count == 0)
+    {
+        cerr << "Invalid value for " << arg << ": " << value << endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv)
 {
     srand(time(NULL)); // seed generator with time
 
+    // --capture <dir> writes an image sequence, --encode "<command>" pipes raw
+    // RGBA frames to an encoder, --frames <n> limits the length of the run.
+    // --export <file> writes --samples <n> self-play placements as training data.
+    string dir, encoder, exportPath;
+    int frameLimit = 60 * 60 * 10;
+    uint64_t samples = 1000000;
+    for (int i = 1; i < argc; i += 2)
+    {
+        string arg = argv[i];
+        if (i + 1 == argc)
+        {
+            cerr << "Missing value for " << arg << endl;
+            return -1;
+        }
+
+        if (arg == "--capture")
+            dir = argv[i + 1];
+        else if (arg == "--encode")
+            encoder = argv[i + 1];
+        else if (arg == "--frames")
+        {
+            uint64_t count;
+            if (!parseCount(arg, argv[i + 1], count))
+                return -1;
+            frameLimit = min<uint64_t>(count, INT_MAX);
+        }
+        else if (arg == "--export")
+            exportPath = argv[i + 1];
+        else if (arg == "--samples")
+        {
+            if (!parseCount(arg, argv[i + 1], samples))
+                return -1;
+        }
+        else
+        {
+            cerr << "Unknown option " << arg << endl;
+            return -1;
+        }
+    }
+
+    if (!dir.empty() && !encoder.empty())
+    {
+        cerr << "--capture and --encode can't be used together" << endl;
+        return -1;
+    }
+
+    if (!exportPath.empty())
+        return exportTrainingData(exportPath, samples);
+
+    if (!dir.empty() || !encoder.empty())
+    {
+        init();
+        return renderHeadless(frameLimit, dir, encoder);
+    }
+
+    win.create(VideoMode(winSize.x, winSize.y), "Tetris", Style::Titlebar);
+
     Event event;
     init();
 
+    // paused and lost screens only change on input, so once one has been
+    // drawn the loop sleeps in waitEvent instead of redrawing every frame
+    bool redraw = true;
+
     while (win.isOpen())
     {
         softDrop = false;
 
+        if (!redraw && win.waitEvent(event))
+        {
+            handleEvent(event);
+            redraw = true;
+        }
+
         while (win.pollEvent(event))
         {
-            if (event.type == Event::KeyPressed)
-                input(event.key.code);
-            else if (event.type == Event::Closed)
-                win.close();
+            handleEvent(event);
+            redraw = true;
         }
 
+        if (!win.isOpen())
+            break;
+
+        bool wasLost = lost;
+
         win.clear();
 
         updateGame();
 
         win.display();
         ++frameTimer;
+
+        // gravity can lose the game mid-frame, after the board was drawn,
+        // so that frame still needs the game over screen drawn after it
+        redraw = (!paused && !lost) || lost != wasLost;
     }
 
+    // don't wait out the hint's time limit when quitting
+    pcStop = true;
+    if (hintSearch.valid())
+        hintSearch.wait();
+
     return 0;
 }
@@ -0,0 +1,370 @@
+#ifndef PCSOLVER_H
+#define PCSOLVER_H
+
+#include "libs.hpp"
+#include "bitboard.hpp"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/*
+    Perfect clear search. Only the bottom 4 rows are considered, stored in a
+    uint64_t with bit y * 10 + x set for a filled cell. Pieces are hard dropped
+    straight down from above the field, like the game's hard drop, so solutions
+    that need a slide or kick are not found.
+
+    Every state must pass three checks before it is expanded:
+    - cell count: the empty cells need exactly as many pieces as are left
+    - regions: a fully filled column is a wall no piece can cross, so the empty
+      cells between walls must come in multiples of 4
+    - column parity: only I, L, J and T can fill uneven numbers of cells in
+      even and odd columns, so the imbalance of every region must be within
+      what the pieces still to be placed can fix
+*/
+
+enum { pcNone, pcFound, pcTimeout, pcTooHigh }; // pcTooHigh: the board reaches above the rows searched
+
+struct PCResult
+{
+    int status;
+    vector<Placement> moves;
+};
+
+const int pcMaxHeight = 4;
+const int pcVisitedBits = 22; // 32MB of visited states
+const int pcGenerationShift = 51; // state keys use the bits below this
+const uint64_t pcRow = (1ull << 10) - 1;
+
+// A distinct set of cells a tetromino can cover, moved down to row 0
+struct PCShape
+{
+    uint64_t mask;
+    int rot, x, bottom, height;
+};
+
+array<vector<PCShape>, N> pcShapes;
+array<uint64_t, 10> pcColumns; // every cell of column x
+
+// States already being searched, an open addressed table shared by all
+// threads. It is allocated once; entries from older searches are told apart by
+// the generation in their top bits and count as empty.
+unique_ptr<atomic<uint64_t>[]> pcVisited;
+uint64_t pcGeneration = 0;
+mutex pcLock;           // one search at a time, they share pcVisited
+atomic<bool> pcStop(false); // set to abandon searches, e.g. when quitting
+
+void buildPCShapes()
+{
+    for (int x = 0; x < 10; ++x)
+        for (int y = 0; y < pcMaxHeight; ++y)
+            pcColumns[x] |= 1ull << (y * 10 + x);
+
+    for (int tet = 0; tet < N; ++tet)
+        for (int rot = 0; rot < 4; ++rot)
+            for (int x = -3; x < 10; ++x)
+            {
+                array<int, 4> rows;
+                int bottom = -1, top = 0;
+                bool valid = true;
+
+                for (int k = 0; k < 4; ++k)
+                {
+                    rows[k] = pieceRow(tet, rot, k, x);
+                    valid &= rows[k] != -1;
+
+                    if (rows[k] > 0)
+                    {
+                        if (bottom == -1)
+                            bottom = k;
+                        top = k;
+                    }
+                }
+
+                if (!valid)
+                    continue;
+
+                PCShape shape = {0, rot, x, bottom, top - bottom + 1};
+                for (int k = bottom; k <= top; ++k)
+                    shape.mask |= (uint64_t)rows[k] << ((k - bottom) * 10);
+
+                bool seen = false;
+                for (const PCShape& other : pcShapes[tet])
+                    seen |= other.mask == shape.mask;
+
+                if (!seen)
+                    pcShapes[tet].push_back(shape);
+            }
+}
+
+// Remove full rows below height, returning how many were cleared
+int pcClear(uint64_t& field, int height)
+{
+    uint64_t out = 0;
+    int kept = 0;
+
+    for (int y = 0; y < height; ++y)
+    {
+        uint64_t row = field >> (y * 10) & pcRow;
+        if (row != pcRow)
+            out |= row << (kept++ * 10);
+    }
+
+    field = out;
+    return height - kept;
+}
+
+struct PCSearch
+{
+    vector<int> queue;
+    int maxPieces;
+    chrono::steady_clock::time_point deadline;
+
+    atomic<bool> found, timedOut;
+    mutex solutionLock;
+    vector<Placement> solution;
+};
+
+// Returns true the first time a state is seen by any thread
+bool pcVisit(uint64_t field, int height, int next, int held)
+{
+    uint64_t key = field | (uint64_t)height << 40 | (uint64_t)next << 43 | (uint64_t)held << 48;
+    uint64_t tagged = key | pcGeneration << pcGenerationShift;
+    uint64_t slot = key * 0x9e3779b97f4a7c15ull >> (64 - pcVisitedBits);
+
+    for (int probe = 0; probe < 64; ++probe)
+    {
+        atomic<uint64_t>& entry = pcVisited[(slot + probe) & ((1 << pcVisitedBits) - 1)];
+        uint64_t seen = entry.load(memory_order_relaxed);
+
+        if (seen >> pcGenerationShift != pcGeneration && entry.compare_exchange_strong(seen, tagged, memory_order_relaxed))
+            return true;
+        if (seen == tagged)
+            return false;
+    }
+
+    return true; // table is crowded here, search the state again rather than miss it
+}
+
+bool pcFeasible(const PCSearch& search, uint64_t field, int height, int next, int held, int placed)
+{
+    uint64_t area = (1ull << (height * 10)) - 1;
+    uint64_t empty = ~field & area;
+
+    int cells = __builtin_popcountll(empty);
+    int available = search.queue.size() - next + (held != N);
+    if (cells % 4 != 0 || cells / 4 > available || placed + cells / 4 > search.maxPieces)
+        return false;
+
+    // column parity, fixable by at most the cells / 4 pieces still to be
+    // placed, so count the best of them: I first, then L, J and T
+    int fours = 0, twos = 0;
+    for (int i = next; i <= search.queue.size(); ++i)
+    {
+        int tet = i < search.queue.size() ? search.queue[i] : held;
+        fours += tet == I;
+        twos += tet == L || tet == J || tet == T;
+    }
+
+    int pieces = cells / 4;
+    int uneven = 4 * min(fours, pieces) + 2 * min(twos, pieces - min(fours, pieces));
+
+    // regions between filled columns, each needing a multiple of 4 cells and
+    // fixing its own parity since no piece crosses a filled column. A region
+    // off by 2 mod 4 also needs an L, J or T of its own.
+    int region = 0, balance = 0, imbalance = 0, oddRegions = 0;
+    for (int x = 0; x <= 10; ++x)
+    {
+        int count = x < 10 ? __builtin_popcountll(empty & pcColumns[x]) : 0;
+        if (count == 0)
+        {
+            if (region % 4 != 0)
+                return false;
+
+            imbalance += abs(balance);
+            oddRegions += abs(balance) % 4 == 2;
+            region = balance = 0;
+        }
+        else
+        {
+            region += count;
+            balance += x % 2 ? -count : count;
+        }
+    }
+
+    return imbalance <= uneven && oddRegions <= min(twos, pieces);
+}
+
+// Drop one piece and search on from the resulting state
+bool pcSearch(PCSearch& search, uint64_t field, int height, int next, int held, vector<Placement>& path);
+
+bool pcTry(PCSearch& search, uint64_t field, int height, int tet, const PCShape& shape,
+           bool usedHold, int next, int held, vector<Placement>& path)
+{
+    // drop from above the field, where nothing is in the way
+    int y = height;
+    while (y > 0 && !(field & shape.mask << ((y - 1) * 10)))
+        --y;
+
+    if (y + shape.height > height)
+        return false;
+
+    field |= shape.mask << (y * 10);
+    int cleared = pcClear(field, height);
+
+    path.push_back({tet, shape.rot, shape.x, y - shape.bottom, usedHold});
+    if (pcSearch(search, field, height - cleared, next, held, path))
+        return true;
+
+    path.pop_back();
+    return false;
+}
+
+bool pcSearch(PCSearch& search, uint64_t field, int height, int next, int held, vector<Placement>& path)
+{
+    if (height == 0)
+    {
+        lock_guard<mutex> lock(search.solutionLock);
+        if (!search.found)
+        {
+            search.found = true;
+            search.solution = path;
+        }
+        return true;
+    }
+
+    if (search.found || search.timedOut)
+        return false;
+
+    if (!pcFeasible(search, field, height, next, held, path.size()) || !pcVisit(field, height, next, held))
+        return false;
+
+    if (pcStop || chrono::steady_clock::now() > search.deadline)
+    {
+        search.timedOut = true;
+        return false;
+    }
+
+    if (next >= search.queue.size())
+        return false;
+
+    int current = search.queue[next];
+
+    // place the current piece
+    for (const PCShape& shape : pcShapes[current])
+        if (pcTry(search, field, height, current, shape, false, next + 1, held, path))
+            return true;
+
+    // or hold it and place the held piece, or the one after it if nothing is held
+    int swapped = held != N ? held : next + 1 < search.queue.size() ? search.queue[next + 1] : N;
+    if (swapped == N || (held != N && swapped == current))
+        return false;
+
+    for (const PCShape& shape : pcShapes[swapped])
+        if (pcTry(search, field, height, swapped, shape, true, held != N ? next + 1 : next + 2, current, path))
+            return true;
+
+    return false;
+}
+
+// Search the first move of each subtree on a separate thread
+void pcSplit(PCSearch& search, uint64_t field, int height, int held, bool canHold)
+{
+    struct Root { int tet; const PCShape* shape; bool hold; };
+    vector<Root> roots;
+
+    int current = search.queue[0];
+    for (const PCShape& shape : pcShapes[current])
+        roots.push_back({current, &shape, false});
+
+    int swapped = held != N ? held : search.queue.size() > 1 ? search.queue[1] : N;
+    if (canHold && swapped != N && (held == N || swapped != current))
+        for (const PCShape& shape : pcShapes[swapped])
+            roots.push_back({swapped, &shape, true});
+
+    atomic<int> taken(0);
+    auto worker = [&]()
+    {
+        vector<Placement> path;
+        for (int i = taken++; i < roots.size() && !search.found && !search.timedOut; i = taken++)
+        {
+            const Root& root = roots[i];
+            if (!root.hold)
+                pcTry(search, field, height, root.tet, *root.shape, false, 1, held, path);
+            else
+                pcTry(search, field, height, root.tet, *root.shape, true, held != N ? 1 : 2, current, path);
+        }
+    };
+
+    vector<thread> workers;
+    for (int i = 0; i < max(1u, thread::hardware_concurrency()); ++i)
+        workers.push_back(thread(worker));
+
+    for (thread& t : workers)
+        t.join();
+}
+
+// Find moves that clear the board within maxPieces pieces. queue starts with
+// the current piece; canHold is false if hold was already used on it. Calls
+// from several threads run one after another.
+PCResult pcSolve(const Bitboard& board, const vector<int>& queue, int held, bool canHold,
+                 int maxPieces = 10, int timeLimitMs = 1000)
+{
+    lock_guard<mutex> lock(pcLock);
+    if (!pcVisited)
+    {
+        buildPCShapes();
+        pcVisited.reset(new atomic<uint64_t>[1 << pcVisitedBits]());
+    }
+
+    // a new generation empties the table, only wiping it when the counter wraps
+    if (++pcGeneration >> (64 - pcGenerationShift))
+    {
+        pcGeneration = 1;
+        for (int i = 0; i < 1 << pcVisitedBits; ++i)
+            pcVisited[i] = 0;
+    }
+
+    PCResult result = {pcNone, {}};
+    uint64_t field = 0;
+    int top = 0, cells = 0;
+
+    for (int y = 0; y < board.size(); ++y)
+        if (board[y])
+        {
+            if (y >= pcMaxHeight)
+            {
+                result.status = pcTooHigh;
+                return result;
+            }
+
+            field |= (uint64_t)board[y] << (y * 10);
+            top = y + 1;
+            cells += __builtin_popcount(board[y]);
+        }
+
+    if (queue.empty())
+        return result;
+
+    PCSearch search;
+    search.queue = queue;
+    search.maxPieces = maxPieces;
+    search.deadline = chrono::steady_clock::now() + chrono::milliseconds(timeLimitMs);
+    search.found = false;
+    search.timedOut = false;
+
+    // try each clear height the piece count allows, lowest first
+    for (int height = max(top, 1); height <= pcMaxHeight && !search.found; ++height)
+        if ((height * 10 - cells) % 4 == 0)
+            pcSplit(search, field, height, held, canHold);
+
+    if (search.found)
+        result = {pcFound, search.solution};
+    else if (search.timedOut)
+        result.status = pcTimeout;
+
+    return result;
+}
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef PLACER_H
+#define PLACER_H
+
+#include "libs.hpp"
+#include "bitboard.hpp"
+
+// Greedy placer that plays headless games: every placement of the current or
+// held piece is scored and the best one is taken.
+
+const float exploreChance = 0.1; // chance of a random placement instead of the best
+
+// Lower is better: aggregate height, holes and bumpiness
+float evaluate(const Bitboard& board, int rows)
+{
+    array<int, 10> heights{};
+    int holes = 0;
+
+    for (int x = 0; x < heights.size(); ++x)
+        for (int y = board.size() - 1; y >= 0; --y)
+            if (board[y] >> x & 1)
+            {
+                if (!heights[x])
+                    heights[x] = y + 1;
+            }
+            else if (heights[x])
+                ++holes;
+
+    int height = 0, bumpiness = 0;
+    for (int x = 0; x < heights.size(); ++x)
+    {
+        height += heights[x];
+        if (x > 0)
+            bumpiness += abs(heights[x] - heights[x - 1]);
+    }
+
+    return 0.51f * height + 0.36f * holes + 0.18f * bumpiness - 0.76f * rows;
+}
+
+// Pick the best placement of current, or of the held piece (next if nothing is
+// held) when canHold, dropped from y. With rng, sometimes picks a random one
+// instead. Returns false if nothing fits.
+bool choosePlacement(const Bitboard& board, int current, int next, int held, bool canHold, int y,
+                     Placement& best, mt19937* rng = nullptr)
+{
+    array<Placement, 2 * 4 * 12> candidates; // hold, rotation, x
+    int count = 0;
+    float bestScore = INFINITY;
+
+    for (int hold = 0; hold < (canHold ? 2 : 1); ++hold)
+    {
+        int tet = !hold ? current : held != N ? held : next;
+
+        for (int rot = 0; rot < 4; ++rot)
+            for (int x = -2; x < boardDim.x; ++x)
+            {
+                if (!fits(board, tet, rot, x, y))
+                    continue;
+
+                Placement p = {tet, rot, x, dropY(board, tet, rot, x, y), hold == 1};
+                Bitboard after = board;
+                int rows = place(after, tet, rot, p.x, p.y);
+                if (rows < 0)
+                    continue;
+
+                candidates[count++] = p;
+
+                float score = evaluate(after, rows);
+                if (score < bestScore)
+                {
+                    bestScore = score;
+                    best = p;
+                }
+            }
+    }
+
+    if (count > 0 && rng && uniform_real_distribution<float>(0, 1)(*rng) < exploreChance)
+        best = candidates[(*rng)() % count];
+
+    return count > 0;
+}
+
+#endif
@@ -1,4 +1,6 @@
 #!/usr/bin/env sh
 g++ -c -g $1.cpp
-g++ -o $1 $1.o -lsfml-graphics -lsfml-window -lsfml-system
-./$1
+g++ -o $1 $1.o -lsfml-graphics -lsfml-window -lsfml-system -lGL -pthread
+name=$1
+shift
+./$name "$@"
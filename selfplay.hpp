@@ -0,0 +1,118 @@
+#ifndef SELFPLAY_H
+#define SELFPLAY_H
+
+#include "libs.hpp"
+#include "placer.hpp"
+#include "trainingdata.hpp"
+#include <thread>
+
+// Headless games played by the greedy placer, used to export training data.
+// Each thread runs its own game and writes straight into the mapped file.
+
+const int exportChunk = 4096; // records reserved by a thread at a time
+
+struct SelfPlay
+{
+    Bitboard board;
+    int current, next, held;
+    int lines, level;
+    mt19937 rng;
+};
+
+void resetSelfPlay(SelfPlay& game)
+{
+    game.board = Bitboard{};
+    game.current = game.rng() % N;
+    game.next = game.rng() % N;
+    game.held = N;
+    game.lines = 0;
+    game.level = 0;
+}
+
+// Play one placement into record i of columns, restarting the game on a loss
+void selfPlayStep(SelfPlay& game, TrainingColumns& columns, uint64_t i)
+{
+    Placement best{};
+    if (!choosePlacement(game.board, game.current, game.next, game.held, true, spawnPos.y, best, &game.rng))
+    {
+        resetSelfPlay(game);
+        selfPlayStep(game, columns, i);
+        return;
+    }
+
+    columns.board[i] = game.board;
+    columns.current[i] = game.current;
+    columns.next[i] = game.next;
+    columns.held[i] = game.held;
+    columns.hold[i] = best.hold;
+    columns.rotation[i] = best.rot;
+    columns.x[i] = best.x;
+    columns.y[i] = best.y;
+
+    int rows = place(game.board, best.tet, best.rot, best.x, best.y);
+
+    // same as placeTet
+    game.lines += rows;
+    if (game.lines >= 10 * (game.level + 1))
+        ++game.level;
+
+    columns.lines[i] = rows;
+    columns.score[i] = lineScores[rows] * (game.level + 1);
+
+    // advance the queue the way holding then placing does in input and placeTet
+    if (best.hold)
+    {
+        if (game.held == N)
+        {
+            game.held = game.current;
+            game.current = game.next;
+            game.next = game.rng() % N;
+        }
+        else
+            swap(game.held, game.current);
+    }
+
+    game.current = game.next;
+    game.next = game.rng() % N;
+}
+
+void exportWorker(TrainingWriter& writer, unsigned seed)
+{
+    SelfPlay game;
+    game.rng.seed(seed);
+    resetSelfPlay(game);
+
+    while (true)
+    {
+        uint64_t start = trainingReserve(writer, exportChunk);
+        if (start >= writer.capacity)
+            return;
+
+        uint64_t end = min<uint64_t>(start + exportChunk, writer.capacity);
+        for (uint64_t i = start; i < end; ++i)
+            selfPlayStep(game, writer.columns, i);
+    }
+}
+
+// Play headless games on every core until samples placements are written to path
+int exportTrainingData(const string& path, uint64_t samples)
+{
+    TrainingWriter writer;
+    if (!trainingCreate(writer, path, samples))
+        return -1;
+
+    random_device seeder;
+    vector<thread> workers;
+    for (int i = 0; i < max(1u, thread::hardware_concurrency()); ++i)
+        workers.push_back(thread(exportWorker, ref(writer), seeder()));
+
+    for (thread& t : workers)
+        t.join();
+
+    trainingFinish(writer);
+
+    cout << "Wrote " << samples << " samples to " << path << endl;
+    return 0;
+}
+
+#endif
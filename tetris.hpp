@@ -1,3 +1,6 @@
+#ifndef TETRIS_H
+#define TETRIS_H
+
 #include "libs.hpp"
 #include "font.hpp"
 
@@ -34,6 +37,9 @@ const float pressX = centerFont(14, fontSize, winSize.x);   // x pos for "PRESS
 const int lostFontMul = -7; // how many fontSizes to offset from center of screen for top of lost text
 
 const Vector2f nextTetPos(11, boardDim.y - 3);
+const int previewSize = 9;  // pieces known after next, enough for a 10 piece perfect clear
+const int previewTop = 4;   // tiles from the top of the board to the first preview
+const int previewSpacing = 3; // half tiles between previews
 const Vector2f heldTetPos(-5, boardDim.y - 3);
 const Vector2f spawnPos(3, boardDim.y - 4);
 
@@ -71,10 +77,21 @@ bool usedHeld, softDrop, paused, lost;
 
 Vector2f tetPos = spawnPos;
 
-RenderWindow win(VideoMode(winSize.x, winSize.y), "Tetris", Style::Titlebar);
+RenderWindow win; // opened in main, stays closed when rendering headless
+RenderTarget* screen = &win;
 vector<vector<int>> tiles;
 int nextTet;
 int currentTet;
+deque<int> preview;
+
+// take the next piece off the preview and roll a new one onto the end
+int pullTet()
+{
+    int tet = preview.front();
+    preview.pop_front();
+    preview.push_back(rand() % N);
+    return tet;
+}
 
 bool collisionCheck(int rotOffset, int moveOffset)
 {
@@ -102,7 +119,7 @@ void placeTet()
 
     // reset tetromino
     currentTet = nextTet;
-    nextTet = rand() % N;
+    nextTet = pullTet();
     tetPos = spawnPos;
     rotation = 0;
     usedHeld = false;
@@ -160,7 +177,7 @@ void placeTet()
         score += 1200 * (level + 1);
 }
 
-void drawTet(int xOffset, int yOffset, int tet, int rot, bool topCheck)
+void drawTet(int xOffset, int yOffset, int tet, int rot, bool topCheck, Uint8 alpha = 255)
 {
     uint16_t current = tetrominos[tet][rot % 4];
     for (int i = 0; i < 16; ++i)
@@ -173,10 +190,36 @@ void drawTet(int xOffset, int yOffset, int tet, int rot, bool topCheck)
 
             if (!topCheck || y < 20)
             {
-                tile.setFillColor(COLORS[tet]);
+                Color color = COLORS[tet];
+                color.a = alpha;
+
+                tile.setFillColor(color);
                 tile.setPosition(boardPos + Vector2f(tileSize * x, tileSize * ypos));
-                win.draw(tile);
+                screen->draw(tile);
             }
         }
     }
 }
+
+// Draw a tetromino flat at half size with its top left at pos, for the preview
+void drawMiniTet(Vector2f pos, int tet)
+{
+    RectangleShape mini(Vector2f(tileSize / 2.0f, tileSize / 2.0f));
+    mini.setFillColor(COLORS[tet]);
+    mini.setOutlineThickness(0);
+
+    // line up every piece by its top row, rows further up have higher bits
+    uint16_t current = tetrominos[tet][0];
+    int top = 3;
+    while (!(current >> (top * 4) & 0xf))
+        --top;
+
+    for (int i = 0; i < 16; ++i)
+        if (current >> i & 1)
+        {
+            mini.setPosition(pos + Vector2f(i % 4, top - i / 4) * (tileSize / 2.0f));
+            screen->draw(mini);
+        }
+}
+
+#endif
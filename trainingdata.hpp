@@ -0,0 +1,213 @@
+#ifndef TRAININGDATA_H
+#define TRAININGDATA_H
+
+#include "libs.hpp"
+#include "bitboard.hpp"
+#include <atomic>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+    Columnar training data file. A 64 byte header is followed by one column per
+    field, each holding `capacity` fixed-width values and starting on a 64 byte
+    boundary:
+
+        board     Bitboard  board before the placement
+        current   uint8     piece being placed
+        next      uint8
+        held      uint8     N when nothing is held
+        hold      uint8     1 if the placement used hold
+        rotation  uint8     rotation, x and y of the placed piece, as tetPos
+        x         int8
+        y         int8
+        lines     uint8     rows cleared by the placement
+        score     int32     score gained by the placement
+
+    Only the first `count` records are valid.
+*/
+
+const char trainingMagic[8] = {'T', 'E', 'T', 'D', 'A', 'T', 'A', '1'};
+const size_t trainingHeaderSize = 64;
+const array<size_t, 10> trainingWidths({sizeof(Bitboard), 1, 1, 1, 1, 1, 1, 1, 1, 4});
+
+struct TrainingHeader
+{
+    char magic[8];
+    uint64_t count;
+    uint64_t capacity;
+};
+
+// Pointers into a mapped file, see trainingFileSize. Read-only for files opened with trainingOpen.
+struct TrainingColumns
+{
+    Bitboard* board;
+    uint8_t* current;
+    uint8_t* next;
+    uint8_t* held;
+    uint8_t* hold;
+    uint8_t* rotation;
+    int8_t* x;
+    int8_t* y;
+    uint8_t* lines;
+    int32_t* score;
+};
+
+// Size of a file holding capacity records. Also points columns into the
+// mapping at base when given.
+size_t trainingFileSize(uint64_t capacity, TrainingColumns* columns = nullptr, char* base = nullptr)
+{
+    array<size_t, 10> starts;
+    size_t size = trainingHeaderSize;
+
+    for (int i = 0; i < trainingWidths.size(); ++i)
+    {
+        starts[i] = size;
+        size += (trainingWidths[i] * capacity + 63) / 64 * 64;
+    }
+
+    if (columns)
+    {
+        columns->board = (Bitboard*)(base + starts[0]);
+        columns->current = (uint8_t*)(base + starts[1]);
+        columns->next = (uint8_t*)(base + starts[2]);
+        columns->held = (uint8_t*)(base + starts[3]);
+        columns->hold = (uint8_t*)(base + starts[4]);
+        columns->rotation = (uint8_t*)(base + starts[5]);
+        columns->x = (int8_t*)(base + starts[6]);
+        columns->y = (int8_t*)(base + starts[7]);
+        columns->lines = (uint8_t*)(base + starts[8]);
+        columns->score = (int32_t*)(base + starts[9]);
+    }
+
+    return size;
+}
+
+struct TrainingWriter
+{
+    int fd;
+    char* map;
+    size_t size;
+    uint64_t capacity;
+    atomic<uint64_t> reserved;
+    TrainingColumns columns;
+};
+
+// Create a file with room for capacity records and map it for writing
+bool trainingCreate(TrainingWriter& writer, const string& path, uint64_t capacity)
+{
+    writer.capacity = capacity;
+    writer.reserved = 0;
+    writer.size = trainingFileSize(capacity);
+
+    writer.fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (writer.fd < 0 || ftruncate(writer.fd, writer.size) != 0)
+    {
+        cerr << "Error creating " << path << endl;
+        if (writer.fd >= 0)
+            close(writer.fd);
+        return false;
+    }
+
+    writer.map = (char*)mmap(nullptr, writer.size, PROT_READ | PROT_WRITE, MAP_SHARED, writer.fd, 0);
+    if (writer.map == MAP_FAILED)
+    {
+        cerr << "Error mapping " << path << endl;
+        close(writer.fd);
+        return false;
+    }
+
+    madvise(writer.map, writer.size, MADV_SEQUENTIAL);
+    trainingFileSize(capacity, &writer.columns, writer.map);
+
+    return true;
+}
+
+// Claim the next n records for one thread to fill in order. Returns the index
+// of the first one, which may be past the end once the file is full.
+uint64_t trainingReserve(TrainingWriter& writer, uint64_t n)
+{
+    return writer.reserved.fetch_add(n);
+}
+
+// Write the header and unmap. Every reserved record below capacity must have
+// been filled.
+void trainingFinish(TrainingWriter& writer)
+{
+    TrainingHeader header;
+    memcpy(header.magic, trainingMagic, sizeof(header.magic));
+    header.count = min<uint64_t>(writer.reserved, writer.capacity);
+    header.capacity = writer.capacity;
+    memcpy(writer.map, &header, sizeof(header));
+
+    munmap(writer.map, writer.size);
+    close(writer.fd);
+}
+
+struct TrainingData
+{
+    int fd;
+    char* map;
+    size_t size;
+    uint64_t count;
+    TrainingColumns columns;
+};
+
+// Map an exported file read-only. Columns point straight into the mapping.
+bool trainingOpen(TrainingData& data, const string& path)
+{
+    data.fd = open(path.c_str(), O_RDONLY);
+    if (data.fd < 0)
+    {
+        cerr << "Error opening " << path << endl;
+        return false;
+    }
+
+    TrainingHeader header;
+    if (read(data.fd, &header, sizeof(header)) != sizeof(header) ||
+        memcmp(header.magic, trainingMagic, sizeof(header.magic)) != 0)
+    {
+        cerr << path << " is not a training data file" << endl;
+        close(data.fd);
+        return false;
+    }
+
+    // mapping past the end of a truncated file would fault on the first read,
+    // and a corrupt capacity could overflow the size, so bound it by the file first
+    struct stat info;
+    bool valid = fstat(data.fd, &info) == 0 && header.capacity <= (uint64_t)info.st_size / sizeof(Bitboard);
+    if (valid)
+    {
+        data.size = trainingFileSize(header.capacity);
+        valid = (uint64_t)info.st_size >= data.size && header.count <= header.capacity;
+    }
+
+    if (!valid)
+    {
+        cerr << path << " is truncated or corrupt" << endl;
+        close(data.fd);
+        return false;
+    }
+
+    data.count = header.count;
+    data.map = (char*)mmap(nullptr, data.size, PROT_READ, MAP_SHARED, data.fd, 0);
+    if (data.map == MAP_FAILED)
+    {
+        cerr << "Error mapping " << path << endl;
+        close(data.fd);
+        return false;
+    }
+
+    trainingFileSize(header.capacity, &data.columns, data.map);
+    return true;
+}
+
+void trainingClose(TrainingData& data)
+{
+    munmap(data.map, data.size);
+    close(data.fd);
+}
+
+#endif